@@ -19,6 +19,7 @@
 
 
 #include "hal-common/StatusTools.hpp"
+#include "hal-common/Timer.hpp"
 
 
 namespace lr {
@@ -69,6 +70,23 @@ public:
     /// @return The status of the call.
     ///
     virtual Status setBacklightEnabled(bool enabled) = 0;
+
+    /// Set the settle time after each transfer.
+    ///
+    /// Connections without a settle time can ignore this call.
+    ///
+    /// @param microseconds The settle time in microseconds.
+    ///
+    virtual void setSettleDelay(uint16_t microseconds) { (void)microseconds; }
+
+    /// Wait for the display.
+    ///
+    /// The display driver uses this call for all waits, so connections
+    /// can keep track of the time spent.
+    ///
+    /// @param duration The time to wait.
+    ///
+    virtual void delay(Microseconds duration) { Timer::delay(duration); }
 };
     
 
@@ -19,6 +19,7 @@
 
 
 #include "HConnection.hpp"
+#include "HVerifier.hpp"
 
 #include "hal-common/Timer.hpp"
 
@@ -35,6 +36,8 @@ HDisplay::HDisplay(
     _connection(connection),
     _layoutColumns(layoutColumns),
     _layoutRows(layoutRows),
+    _textEncoder(),
+    _timing(),
     _state({})
 {
 }
@@ -58,13 +61,9 @@ HDisplay::Status HDisplay::initialize()
     cmd = Command::Enable;
     if (hasError(_connection->sendCommand(cmd))) return Status::Error;
     // Clear the display
-    cmd = Command::Clear;
-    if (hasError(_connection->sendCommand(cmd))) return Status::Error;
-    Timer::delay(3_ms);
+    if (hasError(sendSlowCommand(Command::Clear))) return Status::Error;
     // Set the cursor to the home position.
-    cmd = Command::Home;
-    if (hasError(_connection->sendCommand(cmd))) return Status::Error;
-    Timer::delay(3_ms);
+    if (hasError(sendSlowCommand(Command::Home))) return Status::Error;
     // Enable the display.
     cmd = Command::Enable;
     cmd |= Command::EnableDisplay;
@@ -79,6 +78,95 @@ HDisplay::Status HDisplay::initialize()
 }
 
 
+void HDisplay::setTextEncoder(const HTextEncoder &textEncoder)
+{
+    _textEncoder = textEncoder;
+    _textEncoder.reset();
+}
+
+
+void HDisplay::setTiming(const HTiming &timing)
+{
+    _timing = timing;
+    _connection->setSettleDelay(_timing.settleDelay);
+}
+
+
+HDisplay::Status HDisplay::calibrateTiming(HVerifier *verifier, const uint8_t safetyMargin)
+{
+    // Delays are reduced in these steps, as long as the display keeps working.
+    const uint16_t settleStep = 5;
+    const uint16_t clearStep = 250;
+    
+    if (verifier == nullptr) return abortCalibration();
+    // Start with the safe default timing, which has to work. Initializing the
+    // display also sets the increment entry mode, the patterns rely on it.
+    setTiming(HTiming());
+    if (hasError(initialize())) return abortCalibration();
+    if (!testPattern(verifier, 0, true)) return abortCalibration();
+    HTiming timing;
+    uint8_t seed = 1;
+    // Find the shortest settle time, using writes without clear.
+    while (timing.settleDelay > settleStep) {
+        _connection->setSettleDelay(timing.settleDelay - settleStep);
+        if (!testPattern(verifier, seed++, false)) {
+            // A lost nibble breaks the 4bit mode, so initialize the display again.
+            setTiming(timing);
+            if (hasError(initialize())) return abortCalibration();
+            break;
+        }
+        timing.settleDelay -= settleStep;
+    }
+    // Find the shortest time for clear and home, using the found settle time for the writes.
+    setTiming(timing);
+    while (timing.clearDelay > clearStep) {
+        _timing.clearDelay = timing.clearDelay - clearStep;
+        if (!testPattern(verifier, seed++, true)) break;
+        if (!testPattern(verifier, seed++, false)) break;
+        timing.clearDelay -= clearStep;
+    }
+    // Add the safety margin, but never exceed the safe defaults.
+    const uint32_t settleDelay = static_cast<uint32_t>(timing.settleDelay) * (100u + safetyMargin) / 100u;
+    const uint32_t clearDelay = static_cast<uint32_t>(timing.clearDelay) * (100u + safetyMargin) / 100u;
+    timing.settleDelay = static_cast<uint16_t>((settleDelay < HTiming::cDefaultSettleDelay) ? settleDelay : HTiming::cDefaultSettleDelay);
+    timing.clearDelay = static_cast<uint16_t>((clearDelay < HTiming::cDefaultClearDelay) ? clearDelay : HTiming::cDefaultClearDelay);
+    setTiming(timing);
+    // Bring the display into a known state, after all the tests.
+    if (hasError(initialize())) return abortCalibration();
+    return Status::Success;
+}
+
+
+HDisplay::Status HDisplay::abortCalibration()
+{
+    setTiming(HTiming());
+    // The calibration failed in any case, this is just the attempt to leave a working display.
+    initialize();
+    return Status::Error;
+}
+
+
+bool HDisplay::testPattern(HVerifier *verifier, const uint8_t seed, const bool clearFirst)
+{
+    // Alternating bit patterns, to catch crosstalk on the data lines.
+    uint8_t pattern[] = {0x55u, 0xAAu, 0x0Fu, 0xF0u, 0x33u, 0xCCu, 0xFFu, 0x00u};
+    for (auto &value : pattern) {
+        value ^= seed;
+    }
+    if (clearFirst) {
+        // The pattern is only written at address zero, if the clear command was executed.
+        if (hasError(clear())) return false;
+    } else {
+        // The same for the home command, the cursor is behind the last pattern.
+        if (hasError(cursorReset())) return false;
+    }
+    for (const auto value : pattern) {
+        if (hasError(_connection->sendData(value))) return false;
+    }
+    return verifier->verify(0, pattern, sizeof(pattern));
+}
+
+
 bool HDisplay::isTwoLineMode() const
 {
     return _layoutRows > 1;
@@ -133,24 +221,21 @@ HDisplay::Status HDisplay::reset()
     
 HDisplay::Status HDisplay::clear()
 {
-    CommandMask cmd = Command::Clear;
-    if (hasError(_connection->sendCommand(cmd))) return Status::Error;
-    Timer::delay(3_ms);
-    return Status::Success;
+    _textEncoder.reset();
+    return sendSlowCommand(Command::Clear);
 }
 
     
 HDisplay::Status HDisplay::cursorReset()
 {
-    CommandMask cmd = Command::Home;
-    if (hasError(_connection->sendCommand(cmd))) return Status::Error;
-    Timer::delay(3_ms);
-    return Status::Success;
+    _textEncoder.reset();
+    return sendSlowCommand(Command::Home);
 }
 
     
 HDisplay::Status HDisplay::setCursor(uint8_t x, uint8_t y)
 {
+    _textEncoder.reset();
     CommandMask cmd = Command::DDAddress;
     cmd |= CommandMask::fromMask(getAddressForPosition(x, y));
     if (hasError(_connection->sendCommand(cmd))) return Status::Error;
@@ -160,7 +245,11 @@ HDisplay::Status HDisplay::setCursor(uint8_t x, uint8_t y)
     
 HDisplay::Status HDisplay::writeChar(char c)
 {
-    _connection->sendData(c);
+    uint8_t romCodes[HTextEncoder::cMaximumRomCodes];
+    const uint8_t count = _textEncoder.encode(static_cast<uint8_t>(c), romCodes);
+    for (uint8_t i = 0; i < count; ++i) {
+        if (hasError(_connection->sendData(romCodes[i]))) return Status::Error;
+    }
     return Status::Success;
 }
 
@@ -168,18 +257,37 @@ HDisplay::Status HDisplay::writeChar(char c)
 HDisplay::Status HDisplay::writeText(const String &text)
 {
     for (String::Size i = 0; i < text.getLength(); ++i) {
-        writeChar(text.getCharAt(i));
+        if (hasError(writeChar(text.getCharAt(i)))) return Status::Error;
     }
-    return Status::Success;
+    return finishText();
 }
 
 
 HDisplay::Status HDisplay::writeText(const char *text)
 {
     while (*text != '\0') {
-        writeChar(*text);
+        if (hasError(writeChar(*text))) return Status::Error;
         ++text;
     }
+    return finishText();
+}
+
+
+HDisplay::Status HDisplay::finishText()
+{
+    uint8_t romCodes[HTextEncoder::cMaximumRomCodes];
+    const uint8_t count = _textEncoder.finish(romCodes);
+    for (uint8_t i = 0; i < count; ++i) {
+        if (hasError(_connection->sendData(romCodes[i]))) return Status::Error;
+    }
+    return Status::Success;
+}
+
+
+HDisplay::Status HDisplay::sendSlowCommand(CommandMask cmd)
+{
+    if (hasError(_connection->sendCommand(cmd))) return Status::Error;
+    _connection->delay(Microseconds(_timing.clearDelay));
     return Status::Success;
 }
 
@@ -18,6 +18,9 @@
 //
 
 
+#include "HTextEncoder.hpp"
+#include "HTiming.hpp"
+
 #include "hal-common/Flags.hpp"
 #include "hal-common/BitTools.hpp"
 #include "hal-lcd-character/CharacterDisplay.hpp"
@@ -28,6 +31,7 @@ namespace lcd {
 
     
 class HConnection;
+class HVerifier;
 
 
 /// The HAL to communicate with a Hitachi HD44780 compatible display.
@@ -75,6 +79,47 @@ public:
     ///
     Status initialize();
 
+    /// Set the encoder for the written text.
+    ///
+    /// By default, all text is sent unchanged to the display. Use an encoder
+    /// in one of the UTF-8 modes to convert text into the character ROM of
+    /// the display while it is written.
+    ///
+    /// @param textEncoder The new text encoder.
+    ///
+    void setTextEncoder(const HTextEncoder &textEncoder);
+
+    /// Get the current timing profile.
+    ///
+    /// @return The timing profile used for all transfers.
+    ///
+    inline const HTiming& getTiming() const { return _timing; }
+
+    /// Set the timing profile.
+    ///
+    /// Use this to restore a profile from a previous calibration,
+    /// without running the calibration again.
+    ///
+    /// @param timing The timing profile to use for all transfers.
+    ///
+    void setTiming(const HTiming &timing);
+
+    /// Calibrate the timing for this display.
+    ///
+    /// This writes test patterns with progressively shorter delays into the
+    /// display memory and checks them with the verifier. The shortest working
+    /// delays plus the safety margin are stored as the new timing profile,
+    /// but never exceed the default values.
+    ///
+    /// The display is initialized before and after the calibration, so all
+    /// settings are reset.
+    ///
+    /// @param verifier The verifier to check the display memory. With `nullptr`, the calibration fails.
+    /// @param safetyMargin The safety margin added to the found delays in percent.
+    /// @return The status of the call. On error, the default timing is used.
+    ///
+    Status calibrateTiming(HVerifier *verifier, uint8_t safetyMargin = 50);
+
 public: // Implement CharacterDisplay.
     Status reset() override;
     Status clear() override;
@@ -130,11 +175,37 @@ protected:
     /// Get the address for a cursor location.
     ///
     virtual uint8_t getAddressForPosition(uint8_t x, uint8_t y);
+
+    /// Replace an incomplete sequence at the end of a text with the fallback glyph.
+    ///
+    Status finishText();
+
+    /// Send a clear or home command and wait until it is executed.
+    ///
+    Status sendSlowCommand(CommandMask cmd);
+
+    /// Write a test pattern to the display and verify it.
+    ///
+    /// @param verifier The verifier to check the display memory.
+    /// @param seed A value to make the pattern different for each test.
+    /// @param clearFirst `true` to clear the display, `false` to only move the cursor home,
+    ///    before writing the pattern.
+    /// @return `true` if the pattern was verified successfully.
+    ///
+    bool testPattern(HVerifier *verifier, uint8_t seed, bool clearFirst);
+
+    /// Restore the default timing and initialize the display after a failed calibration.
+    ///
+    /// @return Always `Status::Error`.
+    ///
+    Status abortCalibration();
     
 protected:
     HConnection* const _connection; ///< The connection to the display.
     const uint8_t _layoutColumns; ///< The number of columns of the display.
     const uint8_t _layoutRows; ///< The number of rows of the display.
+    HTextEncoder _textEncoder; ///< The encoder for the written text.
+    HTiming _timing; ///< The timing profile of the display.
     struct {
         bool increment : 1; ///< If increment is enabled.
         bool autoShift : 1; ///< If auto shift is enabled.
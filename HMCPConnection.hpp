@@ -19,6 +19,7 @@
 
 
 #include "HConnection.hpp"
+#include "HTiming.hpp"
 
 #include "hal-common/Timer.hpp"
 #include "hal-mcp230xx/MCP23008.hpp"
@@ -45,6 +46,15 @@ namespace lcd {
 /// The last pin on the chip can not be used with this implementation.
 /// For performance reasons, direct writes to OLAT are used.
 ///
+/// The backlight can be dimmed and blink in software. There are no timers
+/// involved: the connection keeps its own timeline from the delays it waits,
+/// including the waits of the display driver, and the estimated duration of
+/// each transaction. The state of the light pin is folded into the writes
+/// which are sent anyway for the display data. While no data is sent to the
+/// display, call `updateBacklight()` frequently, e.g. from the main loop,
+/// with a monotonic timestamp. It only starts a transaction if the light pin
+/// actually has to change.
+///
 /// @note Do not call the `initialize()` function. This function will
 ///    be called in the display driver.
 ///
@@ -63,7 +73,106 @@ class HMCPConnection : public HConnection
 public:
     /// Create a new connection.
     ///
-    explicit constexpr HMCPConnection(MCP23008 *io) : _io(io) {}
+    explicit constexpr HMCPConnection(MCP23008 *io)
+    :
+        _io(io),
+        _currentOutput(),
+        _settleDelay(HTiming::cDefaultSettleDelay),
+        _transactionTime(cDefaultTransactionTime),
+        _elapsedTime(0),
+        _countedTime(0),
+        _lastTimestamp(0),
+        _hasTimestamp(false),
+        _backlightLevel(cBacklightLevels),
+        _backlightEnabled(false),
+        _backlightOutput(false),
+        _blinkOffPhase(false),
+        _cycleTime(0),
+        _blinkPhaseLength(0),
+        _blinkTime(0)
+    {
+    }
+
+public:
+    /// The number of backlight levels.
+    ///
+    static constexpr uint8_t cBacklightLevels = 16;
+
+    /// The length of one dimming cycle in microseconds.
+    ///
+    static constexpr uint16_t cBacklightCycleTime = 10000;
+
+    /// The default duration of one write to OLAT in microseconds, for a 400kHz bus.
+    ///
+    static constexpr uint16_t cDefaultTransactionTime = 100;
+
+public:
+    /// Set the duration of one write to OLAT.
+    ///
+    /// This is the time added to the backlight timeline for each transaction.
+    /// It depends on the bus speed, use about 100us for 400kHz and 300us for 100kHz.
+    ///
+    /// @param microseconds The duration of one transaction in microseconds.
+    ///
+    void setTransactionTime(uint16_t microseconds) {
+        _transactionTime = microseconds;
+    }
+
+    /// Set the brightness level of the backlight.
+    ///
+    /// The light pin is switched on once at the start of each dimming cycle
+    /// and switched off after `level` sixteenths of the cycle. So for levels
+    /// between 1 and 15, there are two edges per cycle. While the display is
+    /// idle, each edge costs one transaction, which are at most 200 extra
+    /// transactions per second. The levels 0 and `cBacklightLevels` cost none.
+    /// The new level is used with the next write, there is no extra transaction.
+    ///
+    /// @param level The brightness from 0 (off) to `cBacklightLevels` (full on).
+    ///
+    void setBacklightLevel(uint8_t level) {
+        _backlightLevel = (level > cBacklightLevels) ? cBacklightLevels : level;
+    }
+
+    /// Let the backlight blink.
+    ///
+    /// The light is on for `phaseLength` milliseconds and off for the same time.
+    /// In the on phase, the light uses the level set with `setBacklightLevel()`.
+    /// The new mode is used with the next write, there is no extra transaction.
+    ///
+    /// @param phaseLength The length of each phase in milliseconds, `0` to disable blinking.
+    ///
+    void setBacklightBlinking(uint16_t phaseLength) {
+        _blinkPhaseLength = phaseLength;
+        _blinkTime = 0;
+        _blinkOffPhase = false;
+    }
+
+    /// Advance the backlight timeline while the bus is idle.
+    ///
+    /// The time between two timestamps is added to the timeline, minus the
+    /// time the connection already counted for its own transfers and waits.
+    /// So it does not matter how much was written to the display in between.
+    /// The first call only stores the timestamp.
+    ///
+    /// This will only write to the chip, if the light pin changes its state.
+    /// The precision of dimming depends on how often this method is called,
+    /// call it at least every millisecond for a flicker free light.
+    ///
+    /// @param timestamp A monotonic timestamp in microseconds, which may wrap around.
+    /// @return The status of the call.
+    ///
+    Status updateBacklight(uint32_t timestamp) {
+        if (_hasTimestamp) {
+            const uint32_t timeSinceUpdate = timestamp - _lastTimestamp;
+            if (timeSinceUpdate > _countedTime) {
+                _elapsedTime += timeSinceUpdate - _countedTime;
+            }
+        }
+        _lastTimestamp = timestamp;
+        _hasTimestamp = true;
+        _countedTime = 0;
+        return applyBacklight();
+    }
     
 private:
     /// Get the mask for the data pins.
@@ -84,20 +193,86 @@ private:
         return dataMask()|tRsPin|tEnPin|tLightPin;
     }
     
+    /// Add time spent by the connection to the backlight timeline.
+    ///
+    void addTime(uint32_t microseconds) {
+        _elapsedTime += microseconds;
+        _countedTime += microseconds;
+    }
+
+    /// Wait and add the time to the backlight timeline.
+    ///
+    void delay(Milliseconds duration) {
+        delay(Microseconds(duration.ticks() * 1000u));
+    }
+
+    /// Advance the backlight timeline by the elapsed time and update the light pin.
+    ///
+    void advanceBacklight() {
+        _cycleTime = static_cast<uint16_t>((_cycleTime + _elapsedTime) % cBacklightCycleTime);
+        bool lightOn = _backlightEnabled;
+        if (_blinkPhaseLength != 0) {
+            const uint32_t phaseTime = static_cast<uint32_t>(_blinkPhaseLength) * 1000u;
+            _blinkTime += _elapsedTime;
+            if (_blinkTime >= phaseTime) {
+                if (((_blinkTime / phaseTime) & 1u) != 0) {
+                    _blinkOffPhase = !_blinkOffPhase;
+                }
+                _blinkTime %= phaseTime;
+            }
+            if (_blinkOffPhase) {
+                lightOn = false;
+            }
+        }
+        _elapsedTime = 0;
+        // One run of on time at the start of each cycle.
+        if (static_cast<uint32_t>(_cycleTime) * cBacklightLevels >= static_cast<uint32_t>(_backlightLevel) * cBacklightCycleTime) {
+            lightOn = false;
+        }
+        _backlightOutput = lightOn;
+        if (lightOn) {
+            _currentOutput.setFlag(tLightPin);
+        } else {
+            _currentOutput.clearFlag(tLightPin);
+        }
+    }
+
+    /// Update the light pin, with a write only if its state changes.
+    ///
+    Status applyBacklight() {
+        const bool wasOn = _backlightOutput;
+        advanceBacklight();
+        if (_backlightOutput == wasOn) {
+            return Status::Success;
+        }
+        return writeOutputs();
+    }
+
+    /// Write the current output to the chip, including the current backlight state.
+    ///
+    Status writeOutputs() {
+        advanceBacklight();
+        if (hasError(_io->setAllOutputs(_currentOutput))) {
+            return Status::Error;
+        }
+        addTime(_transactionTime);
+        return Status::Success;
+    }
+
     /// Send four bits.
     ///
     Status sendBits(uint8_t data) {
         _currentOutput.setFlag(tEnPin);
         _currentOutput.changeFlags(dataMaskFromValue(data), dataMask());
-        if (hasError(_io->setAllOutputs(_currentOutput))) {
+        if (hasError(writeOutputs())) {
             return Status::Error;
         }
-        Timer::delay(1_us);
+        delay(1_us);
         _currentOutput.clearFlag(tEnPin);
-        if (hasError(_io->setAllOutputs(_currentOutput))) {
+        if (hasError(writeOutputs())) {
             return Status::Error;
         }
-        Timer::delay(50_us);
+        delay(Microseconds(_settleDelay));
         return Status::Success;
     }
     
@@ -111,19 +286,19 @@ public: // Implement HConnection
             return Status::Error;
         }
         // Start with low states and make sure we wait long enough to the internal reset.
-        if (hasError(_io->setAllOutputs(_currentOutput))) {
+        if (hasError(writeOutputs())) {
             return Status::Error;
         }
-        Timer::delay(20_ms);
+        delay(20_ms);
         // Make sure the display is initialized in 4bit mode.
         if (hasError(sendBits(0b0011))) {
             return Status::Error;
         }
-        Timer::delay(4_ms);
+        delay(4_ms);
         if (hasError(sendBits(0b0011))) {
             return Status::Error;
         }
-        Timer::delay(100_us);
+        delay(100_us);
         if (hasError(sendBits(0b0011))) { // Now the display is in 8bit mode.
             return Status::Error;
         }
@@ -149,20 +324,35 @@ public: // Implement HConnection
     }
     
     Status setBacklightEnabled(bool enabled) override {
-        if (enabled) {
-            _currentOutput.setFlag(tLightPin);
-        } else {
-            _currentOutput.clearFlag(tLightPin);
-        }
-        if (hasError(_io->setAllOutputs(_currentOutput))) {
-            return Status::Error;
-        }
-        return Status::Success;
+        _backlightEnabled = enabled;
+        return applyBacklight();
+    }
+
+    void setSettleDelay(uint16_t microseconds) override {
+        _settleDelay = microseconds;
+    }
+
+    void delay(Microseconds duration) override {
+        Timer::delay(duration);
+        addTime(duration.ticks());
     }
 
 private:
     MCP23008 *_io; ///< The IO interface.
     MCP23008::PinMask _currentOutput; ///< The current output on the chip.
+    uint16_t _settleDelay; ///< The settle time after each transfer in microseconds.
+    uint16_t _transactionTime; ///< The duration of one transaction in microseconds.
+    uint32_t _elapsedTime; ///< The time not yet added to the backlight timeline in microseconds.
+    uint32_t _countedTime; ///< The time counted by the connection since the last timestamp in microseconds.
+    uint32_t _lastTimestamp; ///< The timestamp of the last call to `updateBacklight()`.
+    bool _hasTimestamp; ///< If `_lastTimestamp` is valid.
+    uint8_t _backlightLevel; ///< The brightness level of the backlight.
+    bool _backlightEnabled; ///< If the backlight is enabled.
+    bool _backlightOutput; ///< The current state of the light pin.
+    bool _blinkOffPhase; ///< If the blinking backlight is in the off phase.
+    uint16_t _cycleTime; ///< The position in the dimming cycle in microseconds.
+    uint16_t _blinkPhaseLength; ///< The length of a blink phase in milliseconds, or zero.
+    uint32_t _blinkTime; ///< The position in the current blink phase in microseconds.
 };
 
 
@@ -0,0 +1,643 @@
+//
+// (c)2019 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "HTextEncoder.hpp"
+
+
+namespace lr {
+namespace lcd {
+
+
+namespace {
+
+
+/// A mapping from a unicode code point to a character in the ROM.
+///
+struct Mapping {
+    uint16_t codePoint; ///< The unicode code point.
+    uint8_t romCode; ///< The character code in the ROM.
+};
+
+
+/// Characters of the A00 ROM outside of the ASCII and katakana ranges.
+///
+constexpr Mapping cA00Exact[] = {
+    {0x00A2u, 0xECu}, // ¢
+    {0x00A3u, 0xEDu}, // £
+    {0x00A5u, 0x5Cu}, // ¥
+    {0x00B5u, 0xE4u}, // µ
+    {0x00E4u, 0xE1u}, // ä
+    {0x00F1u, 0xEEu}, // ñ
+    {0x00F6u, 0xEFu}, // ö
+    {0x00F7u, 0xFDu}, // ÷
+    {0x00FCu, 0xF5u}, // ü
+    {0x03A3u, 0xF6u}, // Σ
+    {0x03A9u, 0xF4u}, // Ω
+    {0x03B1u, 0xE0u}, // α
+    {0x03B2u, 0xE2u}, // β
+    {0x03B5u, 0xE3u}, // ε
+    {0x03B8u, 0xF2u}, // θ
+    {0x03BCu, 0xE4u}, // μ
+    {0x03C0u, 0xF7u}, // π
+    {0x03C1u, 0xE6u}, // ρ
+    {0x03C3u, 0xE5u}, // σ
+    {0x2190u, 0x7Fu}, // ←
+    {0x2192u, 0x7Eu}, // →
+    {0x221Au, 0xE8u}, // √
+    {0x221Eu, 0xF3u}, // ∞
+    {0x2588u, 0xFFu}, // █
+    {0x3001u, 0xA4u}, // 、
+    {0x3002u, 0xA1u}, // 。
+    {0x300Cu, 0xA2u}, // 「
+    {0x300Du, 0xA3u}, // 」
+    {0x309Bu, 0xDEu}, // ゛
+    {0x309Cu, 0xDFu}, // ゜
+    {0x30FBu, 0xA5u}, // ・
+    {0x30FCu, 0xB0u}, // ー
+    {0x4E07u, 0xFBu}, // 万
+    {0x5186u, 0xFCu}, // 円
+    {0x5343u, 0xFAu}, // 千
+};
+
+
+/// Similar looking replacements for the A00 ROM.
+///
+constexpr Mapping cA00Nearest[] = {
+    {0x00B0u, 0xDFu}, // ° -> ゜
+    {0x00B7u, 0xA5u}, // · -> ・
+    {0x00DFu, 0xE2u}, // ß -> β
+    {0x0398u, 0xF2u}, // Θ -> θ
+    {0x2126u, 0xF4u}, // Ω (ohm) -> Ω
+    {0x2211u, 0xF6u}, // ∑ -> Σ
+    {0x30EEu, 0xDCu}, // ヮ -> ﾜ
+    {0x30F0u, 0xB2u}, // ヰ -> ｲ
+    {0x30F1u, 0xB4u}, // ヱ -> ｴ
+    {0x30F5u, 0xB6u}, // ヵ -> ｶ
+    {0x30F6u, 0xB9u}, // ヶ -> ｹ
+};
+
+
+/// A full-width katakana, written as half-width katakana and an optional sound mark.
+///
+struct KanaMapping {
+    uint8_t romCode; ///< The half-width katakana in the ROM, or zero if there is none.
+    uint8_t markCode; ///< The voiced or semi-voiced sound mark in the ROM, or zero.
+};
+
+
+/// The first full-width katakana in `cA00Katakana`.
+///
+constexpr uint16_t cFirstKatakana = 0x30A1u;
+
+
+/// The full-width katakana U+30A1 to U+30F6 for the A00 ROM.
+///
+constexpr KanaMapping cA00Katakana[] = {
+    {0xA7u, 0x00u}, // ァ
+    {0xB1u, 0x00u}, // ア
+    {0xA8u, 0x00u}, // ィ
+    {0xB2u, 0x00u}, // イ
+    {0xA9u, 0x00u}, // ゥ
+    {0xB3u, 0x00u}, // ウ
+    {0xAAu, 0x00u}, // ェ
+    {0xB4u, 0x00u}, // エ
+    {0xABu, 0x00u}, // ォ
+    {0xB5u, 0x00u}, // オ
+    {0xB6u, 0x00u}, // カ
+    {0xB6u, 0xDEu}, // ガ
+    {0xB7u, 0x00u}, // キ
+    {0xB7u, 0xDEu}, // ギ
+    {0xB8u, 0x00u}, // ク
+    {0xB8u, 0xDEu}, // グ
+    {0xB9u, 0x00u}, // ケ
+    {0xB9u, 0xDEu}, // ゲ
+    {0xBAu, 0x00u}, // コ
+    {0xBAu, 0xDEu}, // ゴ
+    {0xBBu, 0x00u}, // サ
+    {0xBBu, 0xDEu}, // ザ
+    {0xBCu, 0x00u}, // シ
+    {0xBCu, 0xDEu}, // ジ
+    {0xBDu, 0x00u}, // ス
+    {0xBDu, 0xDEu}, // ズ
+    {0xBEu, 0x00u}, // セ
+    {0xBEu, 0xDEu}, // ゼ
+    {0xBFu, 0x00u}, // ソ
+    {0xBFu, 0xDEu}, // ゾ
+    {0xC0u, 0x00u}, // タ
+    {0xC0u, 0xDEu}, // ダ
+    {0xC1u, 0x00u}, // チ
+    {0xC1u, 0xDEu}, // ヂ
+    {0xAFu, 0x00u}, // ッ
+    {0xC2u, 0x00u}, // ツ
+    {0xC2u, 0xDEu}, // ヅ
+    {0xC3u, 0x00u}, // テ
+    {0xC3u, 0xDEu}, // デ
+    {0xC4u, 0x00u}, // ト
+    {0xC4u, 0xDEu}, // ド
+    {0xC5u, 0x00u}, // ナ
+    {0xC6u, 0x00u}, // ニ
+    {0xC7u, 0x00u}, // ヌ
+    {0xC8u, 0x00u}, // ネ
+    {0xC9u, 0x00u}, // ノ
+    {0xCAu, 0x00u}, // ハ
+    {0xCAu, 0xDEu}, // バ
+    {0xCAu, 0xDFu}, // パ
+    {0xCBu, 0x00u}, // ヒ
+    {0xCBu, 0xDEu}, // ビ
+    {0xCBu, 0xDFu}, // ピ
+    {0xCCu, 0x00u}, // フ
+    {0xCCu, 0xDEu}, // ブ
+    {0xCCu, 0xDFu}, // プ
+    {0xCDu, 0x00u}, // ヘ
+    {0xCDu, 0xDEu}, // ベ
+    {0xCDu, 0xDFu}, // ペ
+    {0xCEu, 0x00u}, // ホ
+    {0xCEu, 0xDEu}, // ボ
+    {0xCEu, 0xDFu}, // ポ
+    {0xCFu, 0x00u}, // マ
+    {0xD0u, 0x00u}, // ミ
+    {0xD1u, 0x00u}, // ム
+    {0xD2u, 0x00u}, // メ
+    {0xD3u, 0x00u}, // モ
+    {0xACu, 0x00u}, // ャ
+    {0xD4u, 0x00u}, // ヤ
+    {0xADu, 0x00u}, // ュ
+    {0xD5u, 0x00u}, // ユ
+    {0xAEu, 0x00u}, // ョ
+    {0xD6u, 0x00u}, // ヨ
+    {0xD7u, 0x00u}, // ラ
+    {0xD8u, 0x00u}, // リ
+    {0xD9u, 0x00u}, // ル
+    {0xDAu, 0x00u}, // レ
+    {0xDBu, 0x00u}, // ロ
+    {0x00u, 0x00u}, // ヮ
+    {0xDCu, 0x00u}, // ワ
+    {0x00u, 0x00u}, // ヰ
+    {0x00u, 0x00u}, // ヱ
+    {0xA6u, 0x00u}, // ヲ
+    {0xDDu, 0x00u}, // ン
+    {0xB3u, 0xDEu}, // ヴ
+    {0x00u, 0x00u}, // ヵ
+    {0x00u, 0x00u}, // ヶ
+};
+
+
+/// Characters of the A02 ROM outside of the ASCII and Latin-1 letter ranges.
+///
+constexpr Mapping cA02Exact[] = {
+    {0x00A1u, 0xA1u}, // ¡
+    {0x00A2u, 0xA2u}, // ¢
+    {0x00A3u, 0xA3u}, // £
+    {0x00A4u, 0xA4u}, // ¤
+    {0x00A5u, 0xA5u}, // ¥
+    {0x00A6u, 0xA6u}, // ¦
+    {0x00A7u, 0xA7u}, // §
+    {0x00A9u, 0xA9u}, // ©
+    {0x00AAu, 0xAAu}, // ª
+    {0x00ABu, 0xABu}, // «
+    {0x00AEu, 0xAEu}, // ®
+    {0x00B0u, 0xB0u}, // °
+    {0x00B1u, 0xB1u}, // ±
+    {0x00B2u, 0xB2u}, // ²
+    {0x00B3u, 0xB3u}, // ³
+    {0x00B5u, 0xB5u}, // µ
+    {0x00B6u, 0xB6u}, // ¶
+    {0x00B7u, 0xB7u}, // ·
+    {0x00B9u, 0xB9u}, // ¹
+    {0x00BAu, 0xBAu}, // º
+    {0x00BBu, 0xBBu}, // »
+    {0x00BCu, 0xBCu}, // ¼
+    {0x00BDu, 0xBDu}, // ½
+    {0x00BEu, 0xBEu}, // ¾
+    {0x00BFu, 0xBFu}, // ¿
+    {0x0192u, 0xA8u}, // ƒ
+    {0x0393u, 0x92u}, // Γ
+    {0x0398u, 0x99u}, // Θ
+    {0x03A3u, 0x94u}, // Σ
+    {0x03A9u, 0x9Au}, // Ω
+    {0x03B1u, 0x90u}, // α
+    {0x03B4u, 0x9Bu}, // δ
+    {0x03B5u, 0x9Eu}, // ε
+    {0x03C0u, 0x93u}, // π
+    {0x03C3u, 0x95u}, // σ
+    {0x03C4u, 0x97u}, // τ
+    {0x03C9u, 0xB8u}, // ω
+    {0x0411u, 0x80u}, // Б
+    {0x0414u, 0x81u}, // Д
+    {0x0416u, 0x82u}, // Ж
+    {0x0417u, 0x83u}, // З
+    {0x0418u, 0x84u}, // И
+    {0x0419u, 0x85u}, // Й
+    {0x041Bu, 0x86u}, // Л
+    {0x041Fu, 0x87u}, // П
+    {0x0423u, 0x88u}, // У
+    {0x0426u, 0x89u}, // Ц
+    {0x0427u, 0x8Au}, // Ч
+    {0x0428u, 0x8Bu}, // Ш
+    {0x0429u, 0x8Cu}, // Щ
+    {0x042Au, 0x8Du}, // Ъ
+    {0x042Bu, 0x8Eu}, // Ы
+    {0x042Du, 0x8Fu}, // Э
+    {0x042Eu, 0xACu}, // Ю
+    {0x042Fu, 0xADu}, // Я
+    {0x2018u, 0xAFu}, // ‘
+    {0x20A7u, 0xB4u}, // ₧
+    {0x221Eu, 0x9Cu}, // ∞
+    {0x2229u, 0x9Fu}, // ∩
+    {0x2665u, 0x9Du}, // ♥
+    {0x266Au, 0x91u}, // ♪
+};
+
+
+/// Similar looking replacements for the A02 ROM.
+///
+constexpr Mapping cA02Nearest[] = {
+    {0x03BCu, 0xB5u}, // μ -> µ
+    {0x2126u, 0x9Au}, // Ω (ohm) -> Ω
+    {0x2211u, 0x94u}, // ∑ -> Σ
+};
+
+
+/// ASCII replacements for typographic characters, valid for both ROMs.
+///
+constexpr Mapping cCommonNearest[] = {
+    {0x00A0u, ' '}, // no-break space
+    {0x00ADu, '-'}, // soft hyphen
+    {0x2010u, '-'}, // ‐
+    {0x2011u, '-'}, // non-breaking hyphen
+    {0x2013u, '-'}, // –
+    {0x2014u, '-'}, // —
+    {0x2018u, '\''}, // ‘
+    {0x2019u, '\''}, // ’
+    {0x201Au, ','}, // ‚
+    {0x201Cu, '"'}, // “
+    {0x201Du, '"'}, // ”
+    {0x201Eu, '"'}, // „
+    {0x2032u, '\''}, // ′
+    {0x2033u, '"'}, // ″
+    {0x2039u, '<'}, // ‹
+    {0x203Au, '>'}, // ›
+    {0x2212u, '-'}, // −
+    {0x2215u, '/'}, // ∕
+    {0x2217u, '*'}, // ∗
+};
+
+
+/// ASCII replacements for the Latin-1 letters U+00C0 to U+00FF.
+///
+constexpr char cLatin1Nearest[] = "AAAAAAACEEEEIIIIDNOOOOOxOUUUUYPsaaaaaaaceeeeiiiidnooooo/ouuuuypy";
+
+
+/// Check if a table is sorted by code point.
+///
+template<uint16_t tSize>
+constexpr bool isSorted(const Mapping (&table)[tSize])
+{
+    for (uint16_t i = 1; i < tSize; ++i) {
+        if (table[i-1].codePoint >= table[i].codePoint) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static_assert(isSorted(cA00Exact), "The A00 table has to be sorted by code point.");
+static_assert(isSorted(cA00Nearest), "The A00 table has to be sorted by code point.");
+static_assert(isSorted(cA02Exact), "The A02 table has to be sorted by code point.");
+static_assert(isSorted(cA02Nearest), "The A02 table has to be sorted by code point.");
+static_assert(isSorted(cCommonNearest), "The common table has to be sorted by code point.");
+static_assert(sizeof(cLatin1Nearest) == 0x41u, "The Latin-1 table has to cover 64 characters.");
+static_assert(sizeof(cA00Katakana) / sizeof(KanaMapping) == 0x56u, "The katakana table has to cover U+30A1 to U+30F6.");
+
+
+/// Search a code point in a table.
+///
+/// @param table The sorted table to search.
+/// @param codePoint The code point to search.
+/// @param romCode A reference to store the found ROM code.
+/// @return `true` if the code point was found.
+///
+template<uint16_t tSize>
+constexpr bool findRomCode(const Mapping (&table)[tSize], const uint32_t codePoint, uint8_t &romCode)
+{
+    uint16_t first = 0;
+    uint16_t last = tSize;
+    while (first < last) {
+        const uint16_t middle = first + (last - first) / 2;
+        if (table[middle].codePoint < codePoint) {
+            first = middle + 1;
+        } else if (table[middle].codePoint > codePoint) {
+            last = middle;
+        } else {
+            romCode = table[middle].romCode;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/// Search the ROM code for a character available in the A00 ROM.
+///
+constexpr bool findA00(const uint32_t codePoint, uint8_t &romCode)
+{
+    // The A00 ROM has a yen sign instead of the backslash and arrows instead of `~` and DEL.
+    if (codePoint < 0x7Eu && codePoint != 0x5Cu) {
+        romCode = static_cast<uint8_t>(codePoint);
+        return true;
+    }
+    // Half-width katakana and punctuation are stored in sequence.
+    if (codePoint >= 0xFF61u && codePoint <= 0xFF9Fu) {
+        romCode = static_cast<uint8_t>(codePoint - 0xFF61u + 0xA1u);
+        return true;
+    }
+    return findRomCode(cA00Exact, codePoint, romCode);
+}
+
+
+/// Search a full-width katakana in the A00 ROM.
+///
+/// @param codePoint The code point to search.
+/// @param romCodes A buffer for two ROM codes.
+/// @return The number of ROM codes, or zero if the character is not available.
+///
+constexpr uint8_t findA00Katakana(const uint32_t codePoint, uint8_t *romCodes)
+{
+    if (codePoint < cFirstKatakana || codePoint >= cFirstKatakana + sizeof(cA00Katakana) / sizeof(KanaMapping)) {
+        return 0;
+    }
+    const KanaMapping &mapping = cA00Katakana[codePoint - cFirstKatakana];
+    if (mapping.romCode == 0) {
+        return 0;
+    }
+    romCodes[0] = mapping.romCode;
+    if (mapping.markCode == 0) {
+        return 1;
+    }
+    romCodes[1] = mapping.markCode;
+    return 2;
+}
+
+
+/// Search the ROM code for a character available in the A02 ROM.
+///
+constexpr bool findA02(const uint32_t codePoint, uint8_t &romCode)
+{
+    // The A02 ROM has the full ASCII range, with a house symbol at DEL.
+    if (codePoint < 0x7Fu) {
+        romCode = static_cast<uint8_t>(codePoint);
+        return true;
+    }
+    // The Latin-1 letters are stored at their code point.
+    if (codePoint >= 0xC0u && codePoint <= 0xFFu) {
+        romCode = static_cast<uint8_t>(codePoint);
+        return true;
+    }
+    return findRomCode(cA02Exact, codePoint, romCode);
+}
+
+
+static_assert([]{ uint8_t romCode = 0; return findA00(0x00E4u, romCode) && romCode == 0xE1u; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCode = 0; return findA00(0xFF71u, romCode) && romCode == 0xB1u; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCode = 0; return !findA00(0x5Cu, romCode); }(), "Lookup failed.");
+static_assert([]{ uint8_t romCode = 0; return findA02(0x042Fu, romCode) && romCode == 0xADu; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCodes[2] = {}; return findA00Katakana(0x30A2u, romCodes) == 1 && romCodes[0] == 0xB1u; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCodes[2] = {}; return findA00Katakana(0x30ACu, romCodes) == 2 && romCodes[0] == 0xB6u && romCodes[1] == 0xDEu; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCodes[2] = {}; return findA00Katakana(0x30D1u, romCodes) == 2 && romCodes[0] == 0xCAu && romCodes[1] == 0xDFu; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCodes[2] = {}; return findA00Katakana(0x30F3u, romCodes) == 1 && romCodes[0] == 0xDDu; }(), "Lookup failed.");
+static_assert([]{ uint8_t romCodes[2] = {}; return findA00Katakana(0x30EEu, romCodes) == 0; }(), "Lookup failed.");
+
+
+/// Write a single ROM code into the buffer.
+///
+/// @return The number of written ROM codes.
+///
+constexpr uint8_t writeRomCode(const uint8_t romCode, uint8_t *romCodes)
+{
+    romCodes[0] = romCode;
+    return 1;
+}
+
+
+/// The result of decoding one byte of UTF-8 text.
+///
+enum class DecodeResult : uint8_t {
+    Pending, ///< The byte is part of an incomplete sequence.
+    CodePoint, ///< The byte completed a code point.
+    Malformed, ///< The byte is malformed.
+    Interrupted, ///< The byte interrupted a sequence, which is malformed. Decode the byte again.
+};
+
+
+/// The state of the UTF-8 decoder.
+///
+struct DecodeState {
+    uint8_t pending; ///< The number of expected continuation bytes.
+    uint8_t lowerBound; ///< The lowest valid value for the next continuation byte.
+    uint8_t upperBound; ///< The highest valid value for the next continuation byte.
+    uint32_t codePoint; ///< The code point of the current sequence.
+};
+
+
+/// Decode the next byte of UTF-8 text.
+///
+/// A byte which does not fit into the current sequence ends the sequence
+/// as malformed and is decoded again. So each maximal subpart of a malformed
+/// sequence is reported once.
+///
+/// @param state The state of the decoder.
+/// @param byte The next byte.
+/// @return The result for the byte.
+///
+constexpr DecodeResult decodeByte(DecodeState &state, const uint8_t byte)
+{
+    if (state.pending != 0) {
+        // Overlong forms, surrogates and code points above U+10FFFF fail on this test.
+        if (byte < state.lowerBound || byte > state.upperBound) {
+            state.pending = 0;
+            return DecodeResult::Interrupted;
+        }
+        state.lowerBound = 0x80u;
+        state.upperBound = 0xBFu;
+        state.codePoint = (state.codePoint << 6u) | (byte & 0b00111111u);
+        if (--state.pending != 0) {
+            return DecodeResult::Pending;
+        }
+        return DecodeResult::CodePoint;
+    }
+    state.lowerBound = 0x80u;
+    state.upperBound = 0xBFu;
+    if ((byte & 0b10000000u) == 0) {
+        state.codePoint = byte;
+        return DecodeResult::CodePoint;
+    } else if (byte >= 0xC2u && byte <= 0xDFu) {
+        state.codePoint = byte & 0b00011111u;
+        state.pending = 1;
+    } else if (byte >= 0xE0u && byte <= 0xEFu) {
+        state.codePoint = byte & 0b00001111u;
+        state.pending = 2;
+        if (byte == 0xE0u) {
+            state.lowerBound = 0xA0u;
+        } else if (byte == 0xEDu) {
+            state.upperBound = 0x9Fu;
+        }
+    } else if (byte >= 0xF0u && byte <= 0xF4u) {
+        state.codePoint = byte & 0b00000111u;
+        state.pending = 3;
+        if (byte == 0xF0u) {
+            state.lowerBound = 0x90u;
+        } else if (byte == 0xF4u) {
+            state.upperBound = 0x8Fu;
+        }
+    } else {
+        // A stray continuation byte, or an overlong or out of range lead byte.
+        return DecodeResult::Malformed;
+    }
+    return DecodeResult::Pending;
+}
+
+
+/// The marker for a malformed sequence in `decodesTo()`.
+///
+constexpr uint32_t cMalformed = 0xFFFFFFFFu;
+
+
+/// Check the decoder with a test text, including the end of the text.
+///
+/// @param text The UTF-8 test text.
+/// @param expected The expected code points, or `cMalformed` for each malformed sequence.
+/// @return `true` if the decoder produces the expected results.
+///
+template<uint8_t tTextSize, uint8_t tExpectedSize>
+constexpr bool decodesTo(const char (&text)[tTextSize], const uint32_t (&expected)[tExpectedSize])
+{
+    DecodeState state = {0, 0x80u, 0xBFu, 0};
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < tTextSize - 1; ++i) {
+        DecodeResult result = decodeByte(state, static_cast<uint8_t>(text[i]));
+        if (result == DecodeResult::Interrupted) {
+            if (count >= tExpectedSize || expected[count++] != cMalformed) return false;
+            result = decodeByte(state, static_cast<uint8_t>(text[i]));
+        }
+        if (result == DecodeResult::Malformed) {
+            if (count >= tExpectedSize || expected[count++] != cMalformed) return false;
+        } else if (result == DecodeResult::CodePoint) {
+            if (count >= tExpectedSize || expected[count++] != state.codePoint) return false;
+        }
+    }
+    if (state.pending != 0) {
+        if (count >= tExpectedSize || expected[count++] != cMalformed) return false;
+    }
+    return count == tExpectedSize;
+}
+
+
+static_assert([]{ const uint32_t expected[] = {0x41u, 0xE4u, 0x20ACu, 0x1F600u};
+    return decodesTo("A\xC3\xA4\xE2\x82\xAC\xF0\x9F\x98\x80", expected); }(), "Valid text failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, 0x41u};
+    return decodesTo("\xE2\x82" "A", expected); }(), "Interrupted sequence failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, 0xE4u};
+    return decodesTo("\xE2\xC3\xA4", expected); }(), "Interrupted sequence failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed};
+    return decodesTo("\x80", expected); }(), "Stray continuation byte failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, cMalformed};
+    return decodesTo("\xC0\xAF", expected); }(), "Overlong sequence failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, cMalformed};
+    return decodesTo("\xE0\x80", expected); }(), "Overlong sequence failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, cMalformed, cMalformed};
+    return decodesTo("\xE0\x80\x80", expected); }(), "Overlong sequence failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, cMalformed, cMalformed};
+    return decodesTo("\xED\xA0\x80", expected); }(), "Surrogate failed.");
+static_assert([]{ const uint32_t expected[] = {cMalformed, cMalformed, cMalformed, cMalformed};
+    return decodesTo("\xF4\x90\x80\x80", expected); }(), "Code point above U+10FFFF failed.");
+static_assert([]{ const uint32_t expected[] = {0x78u, cMalformed};
+    return decodesTo("x\xC3", expected); }(), "Truncated sequence failed.");
+static_assert([]{ const uint32_t expected[] = {0x78u, cMalformed};
+    return decodesTo("x\xF0\x9F\x98", expected); }(), "Truncated sequence failed.");
+
+
+}
+
+
+uint8_t HTextEncoder::encode(const uint8_t byte, uint8_t *romCodes)
+{
+    if (_mode == Mode::Raw) {
+        romCodes[0] = byte;
+        return 1;
+    }
+    uint8_t count = 0;
+    DecodeState state = {_pending, _lowerBound, _upperBound, _codePoint};
+    DecodeResult result = decodeByte(state, byte);
+    if (result == DecodeResult::Interrupted) {
+        romCodes[count++] = _fallbackGlyph;
+        result = decodeByte(state, byte);
+    }
+    _pending = state.pending;
+    _lowerBound = state.lowerBound;
+    _upperBound = state.upperBound;
+    _codePoint = state.codePoint;
+    if (result == DecodeResult::Malformed) {
+        romCodes[count++] = _fallbackGlyph;
+    } else if (result == DecodeResult::CodePoint) {
+        count += getRomCodes(_codePoint, romCodes + count);
+    }
+    return count;
+}
+
+
+uint8_t HTextEncoder::finish(uint8_t *romCodes)
+{
+    if (_pending == 0) {
+        return 0;
+    }
+    _pending = 0;
+    romCodes[0] = _fallbackGlyph;
+    return 1;
+}
+
+
+uint8_t HTextEncoder::getRomCodes(const uint32_t codePoint, uint8_t *romCodes) const
+{
+    // Keep the control codes and the custom characters.
+    if (_mode == Mode::Raw || codePoint < 0x20u) {
+        romCodes[0] = static_cast<uint8_t>(codePoint);
+        return 1;
+    }
+    uint8_t romCode = 0;
+    if (_mode == Mode::Utf8ToA00) {
+        if (findA00(codePoint, romCode)) return writeRomCode(romCode, romCodes);
+        if (const uint8_t count = findA00Katakana(codePoint, romCodes); count != 0) return count;
+        if (_fallback == Fallback::Nearest) {
+            // Hiragana is shown as katakana.
+            const uint32_t katakana = (codePoint >= 0x3041u && codePoint <= 0x3096u) ? (codePoint + 0x60u) : codePoint;
+            if (const uint8_t count = findA00Katakana(katakana, romCodes); count != 0) return count;
+            if (findRomCode(cA00Nearest, katakana, romCode)) return writeRomCode(romCode, romCodes);
+        }
+    } else {
+        if (findA02(codePoint, romCode)) return writeRomCode(romCode, romCodes);
+        if (_fallback == Fallback::Nearest && findRomCode(cA02Nearest, codePoint, romCode)) return writeRomCode(romCode, romCodes);
+    }
+    if (_fallback == Fallback::Nearest) {
+        if (findRomCode(cCommonNearest, codePoint, romCode)) return writeRomCode(romCode, romCodes);
+        if (codePoint >= 0xC0u && codePoint <= 0xFFu) return writeRomCode(static_cast<uint8_t>(cLatin1Nearest[codePoint - 0xC0u]), romCodes);
+    }
+    return writeRomCode(_fallbackGlyph, romCodes);
+}
+}
+}
+
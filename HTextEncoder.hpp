@@ -0,0 +1,142 @@
+#pragma once
+//
+// (c)2019 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <cstdint>
+
+
+namespace lr {
+namespace lcd {
+
+
+/// A streaming encoder from UTF-8 text into the character ROM of the display.
+///
+/// The encoder is fed byte by byte and keeps the state of an incomplete
+/// UTF-8 sequence between the calls. Therefore text can be written directly
+/// from the source buffer to the connection, without any temporary strings.
+///
+/// The lookup tables for the A00 (Japanese) and A02 (European) character
+/// ROMs are compile-time constants. On the A00 ROM, full-width katakana
+/// is written as half-width katakana, voiced and semi-voiced characters
+/// use a second ROM code for the sound mark (e.g. `ガ` as `ｶﾞ`). Characters which are not part of the
+/// selected ROM are either replaced by the nearest match (e.g. `Ä` with `A`
+/// on the A00 ROM), or by a fixed glyph. The glyph can also be one of the
+/// custom characters 0-7 from the CG RAM.
+///
+/// Code points below 0x20 are passed unchanged, so the custom characters
+/// stay accessible in every mode.
+///
+class HTextEncoder
+{
+public:
+    /// The encoding mode.
+    ///
+    enum class Mode : uint8_t {
+        Raw, ///< Send all bytes unchanged to the display.
+        Utf8ToA00, ///< Convert UTF-8 text into the A00 (Japanese) ROM.
+        Utf8ToA02, ///< Convert UTF-8 text into the A02 (European) ROM.
+    };
+
+    /// The handling of characters missing in the ROM.
+    ///
+    enum class Fallback : uint8_t {
+        Nearest, ///< Use the nearest match, or the fallback glyph if there is none.
+        Glyph, ///< Always use the fallback glyph.
+    };
+
+    /// The maximum number of ROM codes produced by a single call to `encode()`.
+    ///
+    /// This is the fallback glyph for an interrupted sequence, followed by a
+    /// katakana with its sound mark.
+    ///
+    static constexpr uint8_t cMaximumRomCodes = 3;
+
+public:
+    /// Create a new encoder.
+    ///
+    /// @param mode The encoding mode.
+    /// @param fallback The handling of characters missing in the ROM.
+    /// @param fallbackGlyph The ROM code used for missing characters and malformed sequences.
+    ///
+    constexpr explicit HTextEncoder(
+        Mode mode = Mode::Raw,
+        Fallback fallback = Fallback::Nearest,
+        uint8_t fallbackGlyph = '?')
+    :
+        _mode(mode),
+        _fallback(fallback),
+        _fallbackGlyph(fallbackGlyph),
+        _pending(0),
+        _lowerBound(0x80u),
+        _upperBound(0xBFu),
+        _codePoint(0)
+    {
+    }
+
+public:
+    /// Encode the next byte of the text.
+    ///
+    /// Bytes of an incomplete sequence produce no output. An interrupted or
+    /// malformed sequence is replaced with the fallback glyph.
+    ///
+    /// @param byte The next byte of the text.
+    /// @param romCodes A buffer for at least `cMaximumRomCodes` ROM codes.
+    /// @return The number of ROM codes written into the buffer.
+    ///
+    uint8_t encode(uint8_t byte, uint8_t *romCodes);
+
+    /// End the text.
+    ///
+    /// An incomplete sequence at the end of the text is replaced with
+    /// the fallback glyph. Afterwards, the encoder is reset.
+    ///
+    /// @param romCodes A buffer for at least `cMaximumRomCodes` ROM codes.
+    /// @return The number of ROM codes written into the buffer.
+    ///
+    uint8_t finish(uint8_t *romCodes);
+
+    /// Get the ROM codes for a single unicode code point.
+    ///
+    /// This uses the ROM and fallback settings of this encoder. In raw mode,
+    /// the lower 8 bits of the code point are returned.
+    ///
+    /// @param codePoint The unicode code point.
+    /// @param romCodes A buffer for at least two ROM codes.
+    /// @return The number of ROM codes written into the buffer.
+    ///
+    uint8_t getRomCodes(uint32_t codePoint, uint8_t *romCodes) const;
+
+    /// Discard any incomplete sequence.
+    ///
+    inline void reset() { _pending = 0; }
+
+private:
+    Mode _mode; ///< The encoding mode.
+    Fallback _fallback; ///< The handling of missing characters.
+    uint8_t _fallbackGlyph; ///< The ROM code for missing characters.
+    uint8_t _pending; ///< The number of expected continuation bytes.
+    uint8_t _lowerBound; ///< The lowest valid value for the next continuation byte.
+    uint8_t _upperBound; ///< The highest valid value for the next continuation byte.
+    uint32_t _codePoint; ///< The code point of the current sequence.
+};
+
+
+}
+}
+
@@ -0,0 +1,52 @@
+#pragma once
+//
+// (c)2019 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+
+#include <cstdint>
+
+
+namespace lr {
+namespace lcd {
+
+
+/// The timing profile for a display.
+///
+/// The default values are safe for all HD44780 compatible controllers.
+/// Many modules work with shorter delays, use `HDisplay::calibrateTiming()`
+/// to find the values for a specific module.
+///
+struct HTiming
+{
+    /// The default settle time after each transfer in microseconds.
+    ///
+    static constexpr uint16_t cDefaultSettleDelay = 50;
+
+    /// The default execution time of the clear and home commands in microseconds.
+    ///
+    static constexpr uint16_t cDefaultClearDelay = 3000;
+
+    uint16_t settleDelay = cDefaultSettleDelay; ///< The settle time after each transfer in microseconds.
+    uint16_t clearDelay = cDefaultClearDelay; ///< The execution time of clear and home in microseconds, calibrated on both.
+};
+
+
+}
+}
+
@@ -0,0 +1,52 @@
+#pragma once
+//
+// (c)2019 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+
+#include <cstdint>
+
+
+namespace lr {
+namespace lcd {
+
+
+/// The interface to verify the content of the display memory.
+///
+/// The verifier is used by `HDisplay::calibrateTiming()` to check if the
+/// test patterns arrived in the display. Implement it for a connection
+/// which can read the DDRAM of the display, or for an emulator of the
+/// display on the host.
+///
+class HVerifier
+{
+public:
+    /// Check the display memory.
+    ///
+    /// @param address The DDRAM address of the first byte.
+    /// @param data The expected data.
+    /// @param length The number of bytes to check.
+    /// @return `true` if the memory contains the expected data.
+    ///
+    virtual bool verify(uint8_t address, const uint8_t *data, uint8_t length) = 0;
+};
+
+
+}
+}
+